@@ -0,0 +1,102 @@
+/*
+ * deinvert - a voice inversion descrambler
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace deinvert {
+
+// Checkpoints are raw native-endian dumps of the processing state. They are only meant to
+// be resumed on the same machine, by the same version, with the same options.
+
+constexpr std::array<char, 8> kCheckpointMagic{{'D', 'E', 'I', 'N', 'V', 'C', 'K', '2'}};
+
+template <typename T>
+void WriteValue(std::ostream &out, const T &value) {
+  out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <typename T>
+T ReadValue(std::istream &in) {
+  T value{};
+  in.read(reinterpret_cast<char *>(&value), sizeof(value));
+  if (!in)
+    throw std::runtime_error("checkpoint file is truncated");
+
+  return value;
+}
+
+inline void WriteBool(std::ostream &out, bool value) {
+  WriteValue<uint8_t>(out, value ? 1 : 0);
+}
+
+inline bool ReadBool(std::istream &in) {
+  const auto value = ReadValue<uint8_t>(in);
+  if (value > 1)
+    throw std::runtime_error("checkpoint file is corrupt");
+
+  return value == 1;
+}
+
+inline void WriteString(std::ostream &out, const std::string &value) {
+  WriteValue<uint64_t>(out, value.size());
+  out.write(value.data(), static_cast<std::streamsize>(value.size()));
+}
+
+inline std::string ReadString(std::istream &in) {
+  // Anything longer is a corrupt file rather than a real path
+  constexpr uint64_t kMaxLength = 65536;
+
+  const auto length = ReadValue<uint64_t>(in);
+  if (length > kMaxLength)
+    throw std::runtime_error("checkpoint file is corrupt");
+
+  std::string value(static_cast<size_t>(length), '\0');
+  in.read(&value[0], static_cast<std::streamsize>(length));
+  if (!in)
+    throw std::runtime_error("checkpoint file is truncated");
+
+  return value;
+}
+
+inline void WriteVector(std::ostream &out, const std::vector<float> &values) {
+  WriteValue<uint64_t>(out, values.size());
+  out.write(reinterpret_cast<const char *>(values.data()),
+            static_cast<std::streamsize>(values.size() * sizeof(values[0])));
+}
+
+inline std::vector<float> ReadVector(std::istream &in, size_t expected_size) {
+  if (ReadValue<uint64_t>(in) != expected_size)
+    throw std::runtime_error("checkpoint doesn't match the filter configuration");
+
+  std::vector<float> values(expected_size);
+  in.read(reinterpret_cast<char *>(values.data()),
+          static_cast<std::streamsize>(values.size() * sizeof(values[0])));
+  if (!in)
+    throw std::runtime_error("checkpoint file is truncated");
+
+  return values;
+}
+
+}  // namespace deinvert
@@ -19,13 +19,18 @@
 
 #include <algorithm>
 #include <array>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
 #include <exception>
+#include <fstream>
 #include <iostream>
 #include <memory>
 #include <numeric>
 #include <string>
 #include <vector>
 
+#include "src/checkpoint.h"
 #include "src/io.h"
 #include "src/liquid_wrappers.h"
 #include "src/options.h"
@@ -36,6 +41,10 @@ namespace {
 
 constexpr int kMaxFilterLength = 2047;
 
+// Filter length (in seconds) and stopband attenuation (in dB) per quality setting
+constexpr std::array<float, 4> kFilterLengths{{0.f, 0.0006f, 0.0024f, 0.0064f}};
+constexpr std::array<float, 4> kFilterAttenuation{{60.f, 60.f, 60.f, 80.f}};
+
 int FilterLengthInSamples(float len_seconds, float samplerate) {
   const int filter_length =
       std::min(2 * static_cast<int>(std::round(samplerate * len_seconds)) + 1, kMaxFilterLength);
@@ -43,6 +52,25 @@ int FilterLengthInSamples(float len_seconds, float samplerate) {
   return filter_length;
 }
 
+// Kaiser's estimate for the odd filter length needed for a given transition width
+// (relative to the sample rate) and stopband attenuation
+int FilterLengthForTransition(float transition_width, float attenuation) {
+  if (transition_width <= 0.0f)
+    return kMaxFilterLength;
+
+  const int half_length =
+      static_cast<int>(std::ceil((attenuation - 7.95f) / (14.36f * transition_width) / 2.0f));
+
+  return std::min(2 * half_length + 1, kMaxFilterLength);
+}
+
+// Room between the carrier and the high band's mixing image, relative to the sample rate.
+// The image spans carrier + 2 * split to 2 * carrier + split, and its upper edge folds
+// back to samplerate - split - 2 * carrier if the sample rate is low.
+float HighBandTransitionWidth(float freq_split, float freq_carrier, float samplerate) {
+  return std::min(2.0f * freq_split, samplerate - freq_split - 3.0f * freq_carrier) / samplerate;
+}
+
 }  // namespace
 
 DCRemover::DCRemover(size_t length) : buffer_(length) {}
@@ -72,14 +100,77 @@ float DCRemover::execute(float sample) const {
   }
 }
 
+void DCRemover::SaveState(std::ostream &out) const {
+  WriteVector(out, buffer_);
+  WriteValue<uint64_t>(out, index_);
+  WriteBool(out, is_filled_);
+}
+
+void DCRemover::LoadState(std::istream &in) {
+  buffer_    = ReadVector(in, buffer_.size());
+  index_     = static_cast<size_t>(ReadValue<uint64_t>(in));
+  is_filled_ = ReadBool(in);
+
+  if (index_ >= std::max(buffer_.size(), size_t{1}))
+    throw std::runtime_error("checkpoint doesn't match the filter configuration");
+}
+
+FixedPointDCRemover::FixedPointDCRemover(size_t length) : buffer_(length) {}
+
+void FixedPointDCRemover::push(int16_t sample) {
+  if (buffer_.size() > 0) {
+    sum_ += sample - buffer_[index_];
+    buffer_[index_] = sample;
+    index_          = (index_ + 1) % buffer_.size();
+
+    if (index_ == 0)
+      is_filled_ = true;
+  }
+}
+
+int16_t FixedPointDCRemover::execute(int16_t sample) const {
+  if (buffer_.size() == 0) {
+    return sample;
+  } else {
+    const auto count =
+        static_cast<int32_t>(is_filled_ ? buffer_.size() : std::max(index_, size_t{1}));
+
+    return q15::Saturate(sample - sum_ / count);
+  }
+}
+
+DelayLine::DelayLine(size_t length) : buffer_(length) {}
+
+float DelayLine::execute(float sample) {
+  if (buffer_.size() == 0)
+    return sample;
+
+  const float result = buffer_[index_];
+  buffer_[index_]    = sample;
+  index_             = (index_ + 1) % buffer_.size();
+
+  return result;
+}
+
+void DelayLine::SaveState(std::ostream &out) const {
+  WriteVector(out, buffer_);
+  WriteValue<uint64_t>(out, index_);
+}
+
+void DelayLine::LoadState(std::istream &in) {
+  buffer_ = ReadVector(in, buffer_.size());
+  index_  = static_cast<size_t>(ReadValue<uint64_t>(in));
+
+  if (index_ >= std::max(buffer_.size(), size_t{1}))
+    throw std::runtime_error("checkpoint doesn't match the filter configuration");
+}
+
 Inverter::Inverter(float freq_prefilter, float freq_shift, float freq_postfilter, float samplerate,
                    int filter_quality)
-    : filter_lengths_({0.f, 0.0006f, 0.0024f, 0.0064f}),
-      filter_attenuation_({60.f, 60.f, 60.f, 80.f}),
-      prefilter_(FilterLengthInSamples(filter_lengths_.at(filter_quality), samplerate),
-                 freq_prefilter / samplerate, filter_attenuation_.at(filter_quality)),
-      postfilter_(FilterLengthInSamples(filter_lengths_.at(filter_quality), samplerate),
-                  freq_postfilter / samplerate, filter_attenuation_.at(filter_quality)),
+    : prefilter_(FilterLengthInSamples(kFilterLengths.at(filter_quality), samplerate),
+                 freq_prefilter / samplerate, kFilterAttenuation.at(filter_quality)),
+      postfilter_(FilterLengthInSamples(kFilterLengths.at(filter_quality), samplerate),
+                  freq_postfilter / samplerate, kFilterAttenuation.at(filter_quality)),
       oscillator_(LIQUID_VCO, freq_shift * 2.0f * static_cast<float>(M_PI) / samplerate),
       do_filter_(filter_quality > 0) {}
 
@@ -99,13 +190,300 @@ float Inverter::execute(float insample) {
   return result;
 }
 
+void Inverter::EnableSaveState() {
+  prefilter_.KeepHistory();
+  postfilter_.KeepHistory();
+}
+
+void Inverter::SaveState(std::ostream &out) const {
+  WriteVector(out, prefilter_.history());
+  WriteVector(out, postfilter_.history());
+  WriteValue(out, oscillator_.phase());
+}
+
+void Inverter::LoadState(std::istream &in) {
+  prefilter_.set_history(ReadVector(in, prefilter_.length()));
+  postfilter_.set_history(ReadVector(in, postfilter_.length()));
+  oscillator_.set_phase(ReadValue<float>(in));
+}
+
+FixedPointInverter::FixedPointInverter(float freq_prefilter, float freq_shift,
+                                       float freq_postfilter, float samplerate,
+                                       int filter_quality)
+    : prefilter_(liquid::KaiserTaps(
+          FilterLengthInSamples(kFilterLengths.at(filter_quality), samplerate),
+          freq_prefilter / samplerate, kFilterAttenuation.at(filter_quality))),
+      postfilter_(liquid::KaiserTaps(
+          FilterLengthInSamples(kFilterLengths.at(filter_quality), samplerate),
+          freq_postfilter / samplerate, kFilterAttenuation.at(filter_quality))),
+      oscillator_(freq_shift * 2.0f * static_cast<float>(M_PI) / samplerate),
+      do_filter_(filter_quality > 0) {}
+
+int16_t FixedPointInverter::execute(int16_t insample) {
+  oscillator_.Step();
+
+  int16_t result{};
+
+  if (do_filter_) {
+    prefilter_.push(insample);
+    postfilter_.push(oscillator_.MixUp(prefilter_.execute()));
+    result = postfilter_.execute();
+  } else {
+    result = oscillator_.MixUp(insample);
+  }
+
+  return result;
+}
+
+// The analysis filters share a length, and thus a delay, so the high band can be taken as
+// the difference of the two and the bands sum back exactly. After mixing, the low band's
+// image starts right at the split point and needs a sharp filter. The high band's image
+// usually leaves more room above the carrier, so a shorter filter will do; it is delayed
+// to line up with the low band. If there's no room, we fall back to a full-length filter
+// at the carrier.
+SplitBandInverter::SplitBandInverter(float freq_split, float freq_carrier, float samplerate,
+                                     int filter_quality)
+    : analysis_length_(FilterLengthInSamples(kFilterLengths.at(filter_quality), samplerate)),
+      synthesis_hi_length_(std::min(
+          FilterLengthForTransition(HighBandTransitionWidth(freq_split, freq_carrier, samplerate),
+                                    kFilterAttenuation.at(filter_quality)),
+          analysis_length_)),
+      synthesis_hi_cutoff_(
+          synthesis_hi_length_ < analysis_length_
+              ? std::min(freq_carrier / samplerate +
+                             0.5f * HighBandTransitionWidth(freq_split, freq_carrier, samplerate),
+                         0.5f)
+              : freq_carrier / samplerate),
+      analysis_lo_(analysis_length_, freq_split / samplerate,
+                   kFilterAttenuation.at(filter_quality)),
+      analysis_hi_(analysis_length_, freq_carrier / samplerate,
+                   kFilterAttenuation.at(filter_quality)),
+      synthesis_lo_(analysis_length_, freq_split / samplerate,
+                    kFilterAttenuation.at(filter_quality)),
+      synthesis_hi_(synthesis_hi_length_, synthesis_hi_cutoff_,
+                    kFilterAttenuation.at(filter_quality)),
+      delay_hi_(static_cast<size_t>((analysis_length_ - synthesis_hi_length_) / 2)),
+      oscillator_lo_(LIQUID_VCO, freq_split * 2.0f * static_cast<float>(M_PI) / samplerate),
+      oscillator_hi_(LIQUID_VCO,
+                     (freq_split + freq_carrier) * 2.0f * static_cast<float>(M_PI) / samplerate),
+      do_filter_(filter_quality > 0) {}
+
+float SplitBandInverter::execute(float insample) {
+  oscillator_lo_.Step();
+  oscillator_hi_.Step();
+
+  float result{};
+
+  if (do_filter_) {
+    analysis_lo_.push(insample);
+    analysis_hi_.push(insample);
+    const float band_lo = analysis_lo_.execute();
+    const float band_hi = analysis_hi_.execute() - band_lo;
+
+    synthesis_lo_.push(oscillator_lo_.MixUp({band_lo, 0.0f}).real());
+    synthesis_hi_.push(oscillator_hi_.MixUp({band_hi, 0.0f}).real());
+    result = synthesis_lo_.execute() + delay_hi_.execute(synthesis_hi_.execute());
+  } else {
+    result = oscillator_lo_.MixUp({insample, 0.0f}).real() +
+             oscillator_hi_.MixUp({insample, 0.0f}).real();
+  }
+
+  return result;
+}
+
+void SplitBandInverter::EnableSaveState() {
+  analysis_lo_.KeepHistory();
+  analysis_hi_.KeepHistory();
+  synthesis_lo_.KeepHistory();
+  synthesis_hi_.KeepHistory();
+}
+
+void SplitBandInverter::SaveState(std::ostream &out) const {
+  WriteVector(out, analysis_lo_.history());
+  WriteVector(out, analysis_hi_.history());
+  WriteVector(out, synthesis_lo_.history());
+  WriteVector(out, synthesis_hi_.history());
+  delay_hi_.SaveState(out);
+  WriteValue(out, oscillator_lo_.phase());
+  WriteValue(out, oscillator_hi_.phase());
+}
+
+void SplitBandInverter::LoadState(std::istream &in) {
+  analysis_lo_.set_history(ReadVector(in, analysis_lo_.length()));
+  analysis_hi_.set_history(ReadVector(in, analysis_hi_.length()));
+  synthesis_lo_.set_history(ReadVector(in, synthesis_lo_.length()));
+  synthesis_hi_.set_history(ReadVector(in, synthesis_hi_.length()));
+  delay_hi_.LoadState(in);
+  oscillator_lo_.set_phase(ReadValue<float>(in));
+  oscillator_hi_.set_phase(ReadValue<float>(in));
+}
+
 }  // namespace deinvert
 
+namespace {
+
+constexpr float kCheckpointIntervalSeconds = 10.0f;
+
+// Set on SIGINT/SIGTERM so that we can save a final checkpoint and close the output
+volatile std::sig_atomic_t is_stop_requested = 0;
+
+void RequestStop(int) {
+  is_stop_requested = 1;
+}
+
+constexpr std::array<float, 4> kSimpleGainCompensation{{1.0f, 1.4f, 1.8f, 1.8f}};
+
+// The options that processing state depends on; a checkpoint only fits if these match
+void WriteStateOptions(std::ostream &out, const deinvert::Options &options) {
+  deinvert::WriteValue(out, options.samplerate);
+  deinvert::WriteValue(out, options.quality);
+  deinvert::WriteBool(out, options.is_split_band);
+  deinvert::WriteValue(out, options.frequency_lo);
+  deinvert::WriteValue(out, options.frequency_hi);
+}
+
+bool ReadStateOptionsMatch(std::istream &in, const deinvert::Options &options) {
+  return deinvert::ReadValue<float>(in) == options.samplerate &&
+         deinvert::ReadValue<int>(in) == options.quality &&
+         deinvert::ReadBool(in) == options.is_split_band &&
+         deinvert::ReadValue<float>(in) == options.frequency_lo &&
+         deinvert::ReadValue<float>(in) == options.frequency_hi;
+}
+
+template <typename InverterType>
+void SaveCheckpoint(const deinvert::Options &options, const deinvert::AudioReader &reader,
+                    deinvert::AudioWriter &writer, const deinvert::DCRemover &dcremover,
+                    const InverterType &inverter) {
+  // The checkpoint says how much output there is, so it all has to be written out first
+  if (!writer.flush())
+    throw std::runtime_error("can't write output");
+
+  const std::string tmp_filename = options.checkpoint_filename + ".tmp";
+  {
+    std::ofstream out(tmp_filename, std::ios::binary | std::ios::trunc);
+    out.write(deinvert::kCheckpointMagic.data(), deinvert::kCheckpointMagic.size());
+    WriteStateOptions(out, options);
+    deinvert::WriteString(out, options.infilename);
+    deinvert::WriteValue<int64_t>(out, reader.length());
+    deinvert::WriteString(out, options.outfilename);
+    deinvert::WriteValue<int64_t>(out, reader.position());
+    deinvert::WriteValue<int64_t>(out, writer.position());
+    dcremover.SaveState(out);
+    inverter.SaveState(out);
+    if (!out)
+      throw std::runtime_error(tmp_filename + ": can't write checkpoint");
+  }
+
+  // Replace the old checkpoint only once the new one is complete. Windows won't rename
+  // over an existing file.
+  if (std::rename(tmp_filename.c_str(), options.checkpoint_filename.c_str()) != 0) {
+    std::remove(options.checkpoint_filename.c_str());
+    if (std::rename(tmp_filename.c_str(), options.checkpoint_filename.c_str()) != 0)
+      throw std::runtime_error(options.checkpoint_filename + ": can't write checkpoint");
+  }
+}
+
+// Returns false if there was no checkpoint to resume from
+template <typename InverterType>
+bool LoadCheckpoint(const deinvert::Options &options, deinvert::AudioReader &reader,
+                    deinvert::AudioWriter &writer, deinvert::DCRemover &dcremover,
+                    InverterType &inverter) {
+  std::ifstream in(options.checkpoint_filename, std::ios::binary);
+  if (!in)
+    return false;
+
+  std::array<char, deinvert::kCheckpointMagic.size()> magic{};
+  in.read(magic.data(), magic.size());
+  if (!in || magic != deinvert::kCheckpointMagic)
+    throw std::runtime_error(options.checkpoint_filename + ": not a deinvert checkpoint");
+
+  if (!ReadStateOptionsMatch(in, options))
+    throw std::runtime_error(options.checkpoint_filename +
+                             ": checkpoint was saved with different options");
+
+  // Make sure the checkpoint belongs to these files, so that we don't seek into an
+  // unrelated recording or overwrite part of an unrelated output file
+  const std::string input_filename  = deinvert::ReadString(in);
+  const auto        input_length    = deinvert::ReadValue<int64_t>(in);
+  const std::string output_filename = deinvert::ReadString(in);
+
+  if (input_filename != options.infilename)
+    throw std::runtime_error(options.checkpoint_filename + ": checkpoint is for input file " +
+                             input_filename + ", not " + options.infilename);
+
+  // A recording can only grow
+  if (reader.length() < input_length)
+    throw std::runtime_error(options.checkpoint_filename + ": " + options.infilename +
+                             " is shorter than when the checkpoint was saved; is it the "
+                             "same recording?");
+
+  if (output_filename != options.outfilename)
+    throw std::runtime_error(
+        options.checkpoint_filename + ": checkpoint is for " +
+        (output_filename.empty() ? std::string("stdout") : "output file " + output_filename) +
+        ", not " +
+        (options.outfilename.empty() ? std::string("stdout") : options.outfilename));
+
+  const auto input_position  = deinvert::ReadValue<int64_t>(in);
+  const auto output_position = deinvert::ReadValue<int64_t>(in);
+  dcremover.LoadState(in);
+  inverter.LoadState(in);
+
+  reader.Seek(input_position);
+  writer.Seek(output_position);
+
+  return true;
+}
+
+template <typename InverterType>
+void Descramble(const deinvert::Options &options, std::unique_ptr<deinvert::AudioReader> &reader,
+                std::unique_ptr<deinvert::AudioWriter> &writer, deinvert::DCRemover &dcremover,
+                InverterType &inverter, float gain) {
+  const bool is_checkpointed = !options.checkpoint_filename.empty();
+
+  if (is_checkpointed)
+    inverter.EnableSaveState();
+
+  if (is_checkpointed && LoadCheckpoint(options, *reader, *writer, dcremover, inverter))
+    std::cerr << "deinvert: resuming from frame " << reader->position() << "\n";
+
+  const auto checkpoint_interval =
+      static_cast<int64_t>(options.samplerate * kCheckpointIntervalSeconds);
+  int64_t checkpoint_position = reader->position();
+
+  while (!reader->eof() && !is_stop_requested) {
+    const std::vector<float> block = reader->ReadBlock();
+    for (const float insample : block) {
+      dcremover.push(insample);
+      const bool can_still_write =
+          writer->push(gain * inverter.execute(dcremover.execute(insample)));
+      if (!can_still_write)
+        continue;
+    }
+
+    // A followed file has been caught up with; don't sit on output while waiting for more
+    if (block.empty() && options.is_follow)
+      writer->flush();
+
+    // Also checkpoint whenever a followed file has been caught up with
+    const int64_t since_checkpoint = reader->position() - checkpoint_position;
+    if (is_checkpointed &&
+        (since_checkpoint >= checkpoint_interval || (block.empty() && since_checkpoint > 0))) {
+      SaveCheckpoint(options, *reader, *writer, dcremover, inverter);
+      checkpoint_position = reader->position();
+    }
+  }
+
+  if (is_checkpointed)
+    SaveCheckpoint(options, *reader, *writer, dcremover, inverter);
+}
+
+}  // namespace
+
 void SimpleDescramble(const deinvert::Options                &options,
                       std::unique_ptr<deinvert::AudioReader> &reader,
                       std::unique_ptr<deinvert::AudioWriter> &writer) {
-  static const std::vector<float> filter_gain_compensation({1.0f, 1.4f, 1.8f, 1.8f});
-  float                           gain = filter_gain_compensation.at(options.quality);
+  float gain = kSimpleGainCompensation.at(options.quality);
 
   const int dc_remover_length =
       static_cast<int>(static_cast<float>(options.quality) * options.samplerate * 0.002f);
@@ -115,15 +493,7 @@ void SimpleDescramble(const deinvert::Options                &options,
   deinvert::Inverter inverter(options.frequency_hi, options.frequency_hi, options.frequency_hi,
                               options.samplerate, options.quality);
 
-  while (!reader->eof()) {
-    for (const float insample : reader->ReadBlock()) {
-      dcremover.push(insample);
-      const bool can_still_write =
-          writer->push(gain * inverter.execute(dcremover.execute(insample)));
-      if (!can_still_write)
-        continue;
-    }
-  }
+  Descramble(options, reader, writer, dcremover, inverter, gain);
 }
 
 void SplitBandDescramble(const deinvert::Options                &options,
@@ -137,20 +507,35 @@ void SplitBandDescramble(const deinvert::Options                &options,
 
   deinvert::DCRemover dcremover(dc_remover_length);
 
-  deinvert::Inverter inverter1(options.frequency_lo, options.frequency_lo, options.frequency_lo,
-                               options.samplerate, options.quality);
-  deinvert::Inverter inverter2(options.frequency_hi, options.frequency_lo + options.frequency_hi,
-                               options.frequency_hi, options.samplerate, options.quality);
+  deinvert::SplitBandInverter inverter(options.frequency_lo, options.frequency_hi,
+                                       options.samplerate, options.quality);
 
-  while (!reader->eof()) {
-    for (const float insample : reader->ReadBlock()) {
-      dcremover.push(insample);
-      const float dcremoved = dcremover.execute(insample);
+  Descramble(options, reader, writer, dcremover, inverter, gain);
+}
 
-      const bool can_still_write =
-          writer->push(gain * (inverter1.execute(dcremoved) + inverter2.execute(dcremoved)));
-      if (!can_still_write)
-        continue;
+// Simple inversion of raw 16-bit samples from stdin to stdout, all in Q15
+void FixedPointDescramble(const deinvert::Options &options) {
+  // Gain as Q12, since it's above 1
+  const auto gain =
+      static_cast<int32_t>(std::round(kSimpleGainCompensation.at(options.quality) * 4096.f));
+
+  const int dc_remover_length =
+      static_cast<int>(static_cast<float>(options.quality) * options.samplerate * 0.002f);
+
+  deinvert::FixedPointDCRemover dcremover(dc_remover_length);
+
+  deinvert::FixedPointInverter inverter(options.frequency_hi, options.frequency_hi,
+                                        options.frequency_hi, options.samplerate,
+                                        options.quality);
+
+  deinvert::StdinReader  reader(options);
+  deinvert::RawPCMWriter writer;
+
+  while (!reader.eof()) {
+    for (const int16_t insample : reader.ReadBlockQ15()) {
+      dcremover.push(insample);
+      const int32_t outsample = inverter.execute(dcremover.execute(insample));
+      writer.push(q15::Saturate((outsample * gain + (1 << 11)) >> 12));
     }
   }
 }
@@ -168,6 +553,16 @@ int main(int argc, char **argv) {
   if (options.just_exit)
     return EXIT_FAILURE;
 
+  if (options.is_fixed_point) {
+    try {
+      FixedPointDescramble(options);
+    } catch (std::exception &e) {
+      std::cerr << "error: " << e.what() << std::endl;
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
+
   std::unique_ptr<deinvert::AudioReader> reader;
   std::unique_ptr<deinvert::AudioWriter> writer;
 
@@ -183,10 +578,14 @@ int main(int argc, char **argv) {
     reader = std::unique_ptr<deinvert::AudioReader>(new deinvert::StdinReader(options));
   }
 
+  // When resuming, the output file already has everything up to the checkpoint
+  const bool is_resuming =
+      !options.checkpoint_filename.empty() && std::ifstream(options.checkpoint_filename).good();
+
   if (options.output_type == deinvert::OutputType::wavfile) {
     try {
-      writer = std::unique_ptr<deinvert::AudioWriter>(
-          new deinvert::SndfileWriter(options.outfilename, static_cast<int>(options.samplerate)));
+      writer = std::unique_ptr<deinvert::AudioWriter>(new deinvert::SndfileWriter(
+          options.outfilename, static_cast<int>(options.samplerate), is_resuming));
     } catch (std::exception &e) {
       std::cerr << e.what() << std::endl;
       return EXIT_FAILURE;
@@ -195,9 +594,20 @@ int main(int argc, char **argv) {
     writer = std::unique_ptr<deinvert::AudioWriter>(new deinvert::RawPCMWriter());
   }
 
-  if (options.is_split_band) {
-    SplitBandDescramble(options, reader, writer);
-  } else {
-    SimpleDescramble(options, reader, writer);
+  // Follow mode only ends with a signal, and checkpointing should still get to finish
+  if (options.is_follow || !options.checkpoint_filename.empty()) {
+    std::signal(SIGINT, RequestStop);
+    std::signal(SIGTERM, RequestStop);
+  }
+
+  try {
+    if (options.is_split_band) {
+      SplitBandDescramble(options, reader, writer);
+    } else {
+      SimpleDescramble(options, reader, writer);
+    }
+  } catch (std::exception &e) {
+    std::cerr << "error: " << e.what() << std::endl;
+    return EXIT_FAILURE;
   }
 }
@@ -19,10 +19,13 @@
 
 #include <array>
 #include <cstdint>
+#include <istream>
+#include <ostream>
 #include <string>
 #include <vector>
 
 #include "config.h"
+#include "src/fixed_point.h"
 #include "src/io.h"
 #include "src/liquid_wrappers.h"
 
@@ -33,6 +36,8 @@ class DCRemover {
   explicit DCRemover(size_t length);
   void  push(float sample);
   float execute(float sample) const;
+  void  SaveState(std::ostream &out) const;
+  void  LoadState(std::istream &in);
 
  private:
   std::vector<float> buffer_;
@@ -40,19 +45,85 @@ class DCRemover {
   bool               is_filled_{};
 };
 
+// DCRemover for Q15 samples, keeping a running sum instead of summing the window
+class FixedPointDCRemover {
+ public:
+  explicit FixedPointDCRemover(size_t length);
+  void    push(int16_t sample);
+  int16_t execute(int16_t sample) const;
+
+ private:
+  std::vector<int16_t> buffer_;
+  size_t               index_{};
+  bool                 is_filled_{};
+  int32_t              sum_{};
+};
+
+class DelayLine {
+ public:
+  explicit DelayLine(size_t length);
+  float execute(float sample);
+  void  SaveState(std::ostream &out) const;
+  void  LoadState(std::istream &in);
+
+ private:
+  std::vector<float> buffer_;
+  size_t             index_{};
+};
+
 class Inverter {
  public:
   Inverter(float freq_prefilter, float freq_shift, float freq_postfilter, float samplerate,
            int filter_quality);
   float execute(float insample);
+  // Must be called before processing for SaveState() to work
+  void  EnableSaveState();
+  void  SaveState(std::ostream &out) const;
+  void  LoadState(std::istream &in);
+
+ private:
+  liquid::FIRFilter prefilter_;
+  liquid::FIRFilter postfilter_;
+  liquid::NCO       oscillator_;
+  const bool        do_filter_;
+};
+
+// Inverter for Q15 samples; the filters and oscillator match Inverter's
+class FixedPointInverter {
+ public:
+  FixedPointInverter(float freq_prefilter, float freq_shift, float freq_postfilter,
+                     float samplerate, int filter_quality);
+  int16_t execute(int16_t insample);
+
+ private:
+  q15::FIRFilter prefilter_;
+  q15::FIRFilter postfilter_;
+  q15::NCO       oscillator_;
+  const bool     do_filter_;
+};
+
+// Inverts the bands below and above freq_split separately, using a shared complementary
+// two-band analysis filterbank
+class SplitBandInverter {
+ public:
+  SplitBandInverter(float freq_split, float freq_carrier, float samplerate, int filter_quality);
+  float execute(float insample);
+  void  EnableSaveState();
+  void  SaveState(std::ostream &out) const;
+  void  LoadState(std::istream &in);
 
  private:
-  const std::vector<float> filter_lengths_;
-  const std::vector<float> filter_attenuation_;
-  liquid::FIRFilter        prefilter_;
-  liquid::FIRFilter        postfilter_;
-  liquid::NCO              oscillator_;
-  const bool               do_filter_;
+  const int         analysis_length_;
+  const int         synthesis_hi_length_;
+  const float       synthesis_hi_cutoff_;
+  liquid::FIRFilter analysis_lo_;
+  liquid::FIRFilter analysis_hi_;
+  liquid::FIRFilter synthesis_lo_;
+  liquid::FIRFilter synthesis_hi_;
+  DelayLine         delay_hi_;
+  liquid::NCO       oscillator_lo_;
+  liquid::NCO       oscillator_hi_;
+  const bool        do_filter_;
 };
 
 }  // namespace deinvert
@@ -0,0 +1,99 @@
+/*
+ * deinvert - a voice inversion descrambler
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#include "src/fixed_point.h"
+
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <vector>
+
+namespace q15 {
+
+namespace {
+
+constexpr int kCosTableBits = 12;
+
+int16_t FloatToQ15(float x) {
+  return Saturate(static_cast<int32_t>(std::round(x * 32768.f)));
+}
+
+const std::array<int16_t, 1 << kCosTableBits> &CosTable() {
+  static const std::array<int16_t, 1 << kCosTableBits> table = []() {
+    std::array<int16_t, 1 << kCosTableBits> result{};
+    for (size_t i = 0; i < result.size(); i++)
+      result[i] = FloatToQ15(std::cos(2.0f * static_cast<float>(M_PI) * static_cast<float>(i) /
+                                      static_cast<float>(result.size())));
+    return result;
+  }();
+  return table;
+}
+
+}  // namespace
+
+FIRFilter::FIRFilter(const std::vector<float> &taps)
+    : taps_(taps.size()), window_(2 * taps.size()) {
+  assert(!taps.empty());
+
+  // Reversed, so that the oldest sample in the window meets the last tap. Stored in Q14,
+  // since a long lowpass filter's taps can add up to more than 2 in magnitude.
+  std::transform(taps.rbegin(), taps.rend(), taps_.begin(), [](float tap) {
+    return Saturate(static_cast<int32_t>(std::round(tap * 16384.f)));
+  });
+
+  // With this, the 32-bit accumulator can't overflow
+  int32_t sum_of_magnitudes{};
+  for (const int16_t tap : taps_) sum_of_magnitudes += std::abs(tap);
+  if (sum_of_magnitudes >= 65536)
+    throw std::runtime_error("filter is too long for fixed-point processing");
+}
+
+// The window is stored twice in a row so that the latest taps_.size() samples are always
+// contiguous, and execute() is a plain dot product that the compiler can vectorize
+void FIRFilter::push(int16_t s) {
+  window_[index_]                = s;
+  window_[index_ + taps_.size()] = s;
+  if (++index_ == taps_.size())
+    index_ = 0;
+}
+
+int16_t FIRFilter::execute() const {
+  const int16_t *window = window_.data() + index_;
+
+  int32_t acc = 1 << 13;
+  for (size_t i = 0; i < taps_.size(); i++) acc += int32_t{window[i]} * taps_[i];
+
+  return Saturate(acc >> 14);
+}
+
+NCO::NCO(float freq)
+    : phase_step_(static_cast<uint32_t>(
+          std::llround(static_cast<double>(freq) / (2.0 * M_PI) * 4294967296.0))) {}
+
+// Real part of the sample mixed up by the oscillator
+int16_t NCO::MixUp(int16_t s) const {
+  return Multiply(s, CosTable()[phase_ >> (32 - kCosTableBits)]);
+}
+
+void NCO::Step() {
+  phase_ += phase_step_;
+}
+
+}  // namespace q15
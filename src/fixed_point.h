@@ -0,0 +1,60 @@
+/*
+ * deinvert - a voice inversion descrambler
+ * Copyright (c) Oona Räisänen
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Q15 fixed-point counterparts of the liquid-dsp objects, for processing int16 streams
+// without converting to float and back
+namespace q15 {
+
+inline int16_t Saturate(int32_t x) {
+  return static_cast<int16_t>(std::min(std::max(x, int32_t{-32768}), int32_t{32767}));
+}
+
+// Q15 times Q15, rounded
+inline int16_t Multiply(int16_t a, int16_t b) {
+  return Saturate((int32_t{a} * b + (1 << 14)) >> 15);
+}
+
+class FIRFilter {
+ public:
+  explicit FIRFilter(const std::vector<float> &taps);
+  void    push(int16_t s);
+  int16_t execute() const;
+
+ private:
+  std::vector<int16_t> taps_;
+  std::vector<int16_t> window_;
+  size_t               index_{};
+};
+
+class NCO {
+ public:
+  explicit NCO(float freq);
+  int16_t MixUp(int16_t s) const;
+  void    Step();
+
+ private:
+  uint32_t phase_{};
+  uint32_t phase_step_;
+};
+
+}  // namespace q15
@@ -1,6 +1,11 @@
 #pragma once
 
 #include <array>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <thread>
 #include <vector>
 
 #include <sndfile.h>
@@ -11,17 +16,32 @@ namespace deinvert {
 
 constexpr int kIOBufferSize = 4096;
 
+// How long to wait for a followed file to grow before looking again
+constexpr std::chrono::milliseconds kFollowPollInterval(500);
+
 class AudioReader {
  public:
   virtual ~AudioReader() = default;
   bool eof() const {
     return is_eof_;
   };
+  // Number of frames read so far
+  int64_t position() const {
+    return position_;
+  };
+  // Number of frames in the input, or -1 if it's not known
+  virtual int64_t length() const {
+    return -1;
+  };
   virtual std::vector<float> ReadBlock()        = 0;
   virtual float              samplerate() const = 0;
+  virtual void               Seek(int64_t) {
+    throw std::runtime_error("can't seek in this input");
+  };
 
  protected:
-  bool is_eof_{};
+  bool    is_eof_{};
+  int64_t position_{};
 };
 
 class StdinReader : public AudioReader {
@@ -29,21 +49,35 @@ class StdinReader : public AudioReader {
   explicit StdinReader(const Options &options) : samplerate_(options.samplerate) {}
   ~StdinReader() override = default;
   std::vector<float> ReadBlock() override {
-    const int num_read = fread(buffer_.data(), sizeof(buffer_[0]), kIOBufferSize, stdin);
-
-    if (num_read < kIOBufferSize)
-      is_eof_ = true;
+    const size_t num_read = Fill();
 
     std::vector<float> result(num_read);
-    for (int i = 0; i < num_read; i++) result[i] = buffer_[i] * (1.f / 32768.f);
+    for (size_t i = 0; i < num_read; i++) result[i] = buffer_[i] * (1.f / 32768.f);
 
     return result;
   };
+  // The samples as they are, for the fixed-point path
+  std::vector<int16_t> ReadBlockQ15() {
+    const size_t num_read = Fill();
+
+    return std::vector<int16_t>(buffer_.begin(), buffer_.begin() + num_read);
+  };
   float samplerate() const override {
     return samplerate_;
   };
 
  private:
+  size_t Fill() {
+    const size_t num_read = fread(buffer_.data(), sizeof(buffer_[0]), kIOBufferSize, stdin);
+
+    if (num_read < kIOBufferSize)
+      is_eof_ = true;
+
+    position_ += static_cast<int64_t>(num_read);
+
+    return num_read;
+  };
+
   float                              samplerate_;
   std::array<int16_t, kIOBufferSize> buffer_{};
 };
@@ -51,9 +85,12 @@ class StdinReader : public AudioReader {
 class SndfileReader : public AudioReader {
  public:
   explicit SndfileReader(const Options &options)
-      : info_({0, 0, 0, 0, 0, 0}), file_(sf_open(options.infilename.c_str(), SFM_READ, &info_)) {
+      : filename_(options.infilename),
+        is_follow_(options.is_follow),
+        info_({0, 0, 0, 0, 0, 0}),
+        file_(sf_open(filename_.c_str(), SFM_READ, &info_)) {
     if (file_ == nullptr) {
-      throw std::runtime_error(options.infilename + ": " + sf_strerror(nullptr));
+      throw std::runtime_error(filename_ + ": " + sf_strerror(nullptr));
     } else if (info_.samplerate < options.frequency_hi * 2.0f) {
       throw std::runtime_error("sample rate must be at least twice the inversion frequency");
     }
@@ -69,8 +106,16 @@ class SndfileReader : public AudioReader {
     const int to_read = kIOBufferSize / info_.channels;
 
     const sf_count_t num_read = sf_readf_float(file_, buffer_.data(), to_read);
-    if (num_read != to_read)
+    position_ += num_read;
+
+    // libsndfile only knows the length the file had when it was opened, so in follow mode
+    // we wait a while and then reopen it to see if it has grown
+    if (num_read == 0 && is_follow_) {
+      std::this_thread::sleep_for(kFollowPollInterval);
+      Reopen();
+    } else if (num_read != to_read && !is_follow_) {
       is_eof_ = true;
+    }
 
     if (info_.channels == 1) {
       result = std::vector<float>(buffer_.begin(), buffer_.begin() + num_read);
@@ -83,8 +128,33 @@ class SndfileReader : public AudioReader {
   float samplerate() const override {
     return info_.samplerate;
   };
+  int64_t length() const override {
+    return info_.frames;
+  };
+  void Seek(int64_t frame) override {
+    if (frame > info_.frames && is_follow_)
+      Reopen();
+
+    if (sf_seek(file_, frame, SEEK_SET) != frame)
+      throw std::runtime_error(filename_ + ": can't seek to frame " + std::to_string(frame));
+
+    position_ = frame;
+  };
 
  private:
+  void Reopen() {
+    sf_close(file_);
+    info_ = {0, 0, 0, 0, 0, 0};
+    file_ = sf_open(filename_.c_str(), SFM_READ, &info_);
+    if (file_ == nullptr)
+      throw std::runtime_error(filename_ + ": " + sf_strerror(nullptr));
+
+    if (sf_seek(file_, position_, SEEK_SET) != position_)
+      throw std::runtime_error(filename_ + ": file got shorter while following it");
+  }
+
+  const std::string                filename_;
+  const bool                       is_follow_;
   SF_INFO                          info_;
   SNDFILE                         *file_;
   std::array<float, kIOBufferSize> buffer_{};
@@ -92,23 +162,49 @@ class SndfileReader : public AudioReader {
 
 class AudioWriter {
  public:
-  virtual ~AudioWriter()          = default;
+  virtual ~AudioWriter() = default;
+  // Number of frames written so far
+  int64_t position() const {
+    return position_;
+  };
   virtual bool push(float sample) = 0;
+  // Write out everything pushed so far
+  virtual bool flush()            = 0;
+  virtual void Seek(int64_t frame) = 0;
+
+ protected:
+  int64_t position_{};
 };
 
 class RawPCMWriter : public AudioWriter {
  public:
   RawPCMWriter() = default;
+  ~RawPCMWriter() override {
+    flush();
+  };
   bool push(float sample) override {
-    const int16_t outsample = static_cast<int16_t>(sample * 32767.f);
-    buffer_[buffer_pos_]    = outsample;
+    return push(static_cast<int16_t>(sample * 32767.f));
+  }
+  bool push(int16_t sample) {
+    buffer_[buffer_pos_] = sample;
     buffer_pos_++;
+    position_++;
     if (buffer_pos_ == kIOBufferSize) {
       fwrite(buffer_.data(), sizeof(buffer_[0]), kIOBufferSize, stdout);
       buffer_pos_ = 0;
     }
     return true;
   }
+  bool flush() override {
+    const size_t num_written = fwrite(buffer_.data(), sizeof(buffer_[0]), buffer_pos_, stdout);
+    const bool   success     = (num_written == buffer_pos_ && fflush(stdout) == 0);
+    buffer_pos_              = 0;
+    return success;
+  }
+  // A stream can't be rewound; when resuming, we just carry on writing
+  void Seek(int64_t frame) override {
+    position_ = frame;
+  }
 
  private:
   std::array<int16_t, kIOBufferSize> buffer_{};
@@ -117,11 +213,19 @@ class RawPCMWriter : public AudioWriter {
 
 class SndfileWriter : public AudioWriter {
  public:
-  SndfileWriter(const std::string &fname, int rate)
-      : info_({0, rate, 1, SF_FORMAT_WAV | SF_FORMAT_PCM_16, 0, 0}),
-        file_(sf_open(fname.c_str(), SFM_WRITE, &info_)) {
+  // If is_append is set, an existing file is opened for modification instead of being
+  // overwritten
+  SndfileWriter(const std::string &fname, int rate, bool is_append = false)
+      : fname_(fname),
+        info_({0, rate, 1, SF_FORMAT_WAV | SF_FORMAT_PCM_16, 0, 0}),
+        file_(sf_open(fname.c_str(), is_append ? SFM_RDWR : SFM_WRITE, &info_)) {
     if (file_ == nullptr)
       throw std::runtime_error(fname + ": " + sf_strerror(nullptr));
+
+    if (info_.samplerate != rate || info_.channels != 1) {
+      sf_close(file_);
+      throw std::runtime_error(fname + ": existing file has a different format");
+    }
   }
 
   ~SndfileWriter() override {
@@ -132,20 +236,38 @@ class SndfileWriter : public AudioWriter {
   bool push(float sample) override {
     bool success         = true;
     buffer_[buffer_pos_] = sample;
-    if (buffer_pos_ == kIOBufferSize - 1) {
+    buffer_pos_++;
+    position_++;
+    if (buffer_pos_ == kIOBufferSize)
       success = write();
-    }
 
-    buffer_pos_ = (buffer_pos_ + 1) % kIOBufferSize;
     return success;
   };
 
+  // Also updates the header so that the file is valid as it stands
+  bool flush() override {
+    const bool success = write();
+    sf_command(file_, SFC_UPDATE_HEADER_NOW, nullptr, 0);
+    sf_write_sync(file_);
+    return success;
+  };
+
+  void Seek(int64_t frame) override {
+    write();
+    if (sf_seek(file_, frame, SEEK_SET | SFM_WRITE) != frame)
+      throw std::runtime_error(fname_ + ": can't seek to frame " + std::to_string(frame));
+
+    position_ = frame;
+  };
+
  private:
   bool write() {
-    const sf_count_t num_to_write = buffer_pos_ + 1;
+    const sf_count_t num_to_write = static_cast<sf_count_t>(buffer_pos_);
+    buffer_pos_                   = 0;
     return (file_ != nullptr &&
             sf_write_float(file_, buffer_.data(), num_to_write) == num_to_write);
   }
+  const std::string                fname_;
   SF_INFO                          info_;
   SNDFILE                         *file_;
   std::array<float, kIOBufferSize> buffer_{};
@@ -18,8 +18,10 @@
 
 #include "config.h"
 
+#include <algorithm>
 #include <cassert>
 #include <complex>
+#include <vector>
 
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wdeprecated-declarations"
@@ -32,7 +34,19 @@ extern "C" {
 
 namespace liquid {
 
-FIRFilter::FIRFilter(int len, float fc, float As, float mu) {
+std::vector<float> KaiserTaps(int len, float fc, float As, float mu) {
+  assert(fc >= 0.0f && fc <= 0.5f);
+  assert(As > 0.0f);
+  assert(mu >= -0.5f && mu <= 0.5f);
+
+  std::vector<float> taps(static_cast<size_t>(len));
+  liquid_firdes_kaiser(static_cast<unsigned int>(len), fc, As, mu, taps.data());
+  for (float &tap : taps) tap *= 2.0f * fc;
+
+  return taps;
+}
+
+FIRFilter::FIRFilter(int len, float fc, float As, float mu) : length_(static_cast<size_t>(len)) {
   assert(fc >= 0.0f && fc <= 0.5f);
   assert(As > 0.0f);
   assert(mu >= -0.5f && mu <= 0.5f);
@@ -47,6 +61,12 @@ FIRFilter::~FIRFilter() {
 
 void FIRFilter::push(float s) {
   firfilt_rrrf_push(object_, s);
+
+  if (!history_.empty()) {
+    history_[history_index_] = s;
+    if (++history_index_ == history_.size())
+      history_index_ = 0;
+  }
 }
 
 float FIRFilter::execute() {
@@ -57,6 +77,34 @@ float FIRFilter::execute() {
   return result;
 }
 
+size_t FIRFilter::length() const {
+  return length_;
+}
+
+// liquid-dsp doesn't expose the delay line, so we keep a copy of it for checkpointing.
+// This is off by default to keep push() cheap.
+void FIRFilter::KeepHistory() {
+  history_.assign(length_, 0.0f);
+  history_index_ = 0;
+}
+
+// Pushed samples in chronological order; only available after KeepHistory()
+std::vector<float> FIRFilter::history() const {
+  assert(history_.size() == length_);
+
+  std::vector<float> result(history_.size());
+  std::rotate_copy(history_.begin(), history_.begin() + history_index_, history_.end(),
+                   result.begin());
+  return result;
+}
+
+void FIRFilter::set_history(const std::vector<float> &samples) {
+  assert(samples.size() == length_);
+
+  firfilt_rrrf_reset(object_);
+  for (const float s : samples) push(s);
+}
+
 NCO::NCO(liquid_ncotype type, float freq) : object_(nco_crcf_create(type)) {
   nco_crcf_set_frequency(object_, freq);
 }
@@ -75,4 +123,12 @@ void NCO::Step() {
   nco_crcf_step(object_);
 }
 
+float NCO::phase() const {
+  return nco_crcf_get_phase(object_);
+}
+
+void NCO::set_phase(float phase) {
+  nco_crcf_set_phase(object_, phase);
+}
+
 }  // namespace liquid
@@ -19,6 +19,7 @@
 #include "config.h"
 
 #include <complex>
+#include <vector>
 
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wdeprecated-declarations"
@@ -31,15 +32,25 @@ extern "C" {
 
 namespace liquid {
 
+// Taps of the same lowpass filter that FIRFilter uses, for use outside liquid-dsp
+std::vector<float> KaiserTaps(int len, float fc, float As = 80.0f, float mu = 0.0f);
+
 class FIRFilter {
  public:
   FIRFilter(int len, float fc, float As = 80.0f, float mu = 0.0f);
   ~FIRFilter();
-  void  push(float s);
-  float execute();
+  void               push(float s);
+  float              execute();
+  size_t             length() const;
+  void               KeepHistory();
+  std::vector<float> history() const;
+  void               set_history(const std::vector<float> &samples);
 
  private:
-  firfilt_rrrf object_;
+  firfilt_rrrf       object_;
+  const size_t       length_;
+  std::vector<float> history_;
+  size_t             history_index_{};
 };
 
 class NCO {
@@ -48,6 +59,8 @@ class NCO {
   ~NCO();
   std::complex<float> MixUp(std::complex<float> s);
   void                Step();
+  float               phase() const;
+  void                set_phase(float phase);
 
  private:
   nco_crcf object_;
@@ -16,6 +16,8 @@ enum class OutputType { raw_stdout, wavfile };
 struct Options {
   bool        just_exit{};
   bool        is_split_band{};
+  bool        is_follow{};
+  bool        is_fixed_point{};
   int         quality{2};
   float       samplerate{44100};
   float       frequency_lo{};
@@ -25,10 +27,18 @@ struct Options {
   OutputType  output_type{OutputType::raw_stdout};
   std::string infilename;
   std::string outfilename;
+  std::string checkpoint_filename;
 };
 
 inline void PrintUsage() {
   std::cout << "deinvert [OPTIONS]\n"
+               "\n"
+               "-c, --checkpoint FILE  Save the processing state to FILE every now\n"
+               "                       and then, and resume from it if it exists.\n"
+               "                       Needs -i.\n"
+               "\n"
+               "-F, --follow           Keep reading the input file as it grows,\n"
+               "                       like tail -f. Needs -i.\n"
                "\n"
                "-f, --frequency FREQ   Frequency of the inversion carrier, in "
                "Hertz.\n"
@@ -57,7 +67,12 @@ inline void PrintUsage() {
                "-s, --split-frequency  Split point for split-band inversion, in "
                "Hertz.\n"
                "\n"
-               "-v, --version          Display version string.\n";
+               "-v, --version          Display version string.\n"
+               "\n"
+               "-x, --fixed-point      Process raw 16-bit input in fixed point, without\n"
+               "                       converting it to float. The output differs\n"
+               "                       slightly. Simple inversion from stdin to stdout\n"
+               "                       only.\n";
 }
 
 inline void PrintVersion() {
@@ -68,7 +83,9 @@ inline Options GetOptions(int argc, char **argv) {
   Options options;
 
   // clang-format off
-  const std::array<struct option, 11> long_options{{
+  const std::array<struct option, 14> long_options{{
+      {"checkpoint",      required_argument, nullptr, 'c'},
+      {"follow",          no_argument,       nullptr, 'F'},
       {"frequency",       no_argument,       nullptr, 'f'},
       {"preset",          required_argument, nullptr, 'p'},
       {"input-file",      required_argument, nullptr, 'i'},
@@ -79,6 +96,7 @@ inline Options GetOptions(int argc, char **argv) {
       {"samplerate",      required_argument, nullptr, 'r'},
       {"split-frequency", required_argument, nullptr, 's'},
       {"version",         no_argument,       nullptr, 'v'},
+      {"fixed-point",     no_argument,       nullptr, 'x'},
       {0,                 0,                 nullptr, 0  }
   }};
   // clang-format on
@@ -97,9 +115,11 @@ inline Options GetOptions(int argc, char **argv) {
   bool carrier_frequency_set = false;
   bool carrier_preset_set    = false;
 
-  while ((option_char = getopt_long(argc, argv, "f:hi:no:p:q:r:s:v", long_options.data(),
+  while ((option_char = getopt_long(argc, argv, "c:Ff:hi:no:p:q:r:s:vx", long_options.data(),
                                     &option_index)) >= 0) {
     switch (option_char) {
+      case 'c': options.checkpoint_filename = std::string(optarg); break;
+      case 'F': options.is_follow = true; break;
       case 'i':
         options.infilename = std::string(optarg);
         options.input_type = deinvert::InputType::sndfile;
@@ -138,6 +158,7 @@ inline Options GetOptions(int argc, char **argv) {
         PrintVersion();
         options.just_exit = true;
         break;
+      case 'x': options.is_fixed_point = true; break;
       case 'h':
       default:
         PrintUsage();
@@ -159,6 +180,18 @@ inline Options GetOptions(int argc, char **argv) {
     throw std::runtime_error(
         "don't specify sample rate (-r) with -i; I want to read it from the sound file");
 
+  if (options.input_type == InputType::stdin && options.is_follow)
+    throw std::runtime_error("follow mode (-F) needs an input file (-i)");
+
+  if (options.input_type == InputType::stdin && !options.checkpoint_filename.empty())
+    throw std::runtime_error("checkpointing (-c) needs an input file (-i)");
+
+  if (options.is_fixed_point &&
+      (options.input_type != InputType::stdin || options.output_type != OutputType::raw_stdout ||
+       options.is_split_band))
+    throw std::runtime_error(
+        "fixed-point mode (-x) only does simple inversion from stdin to stdout for now");
+
   if (options.is_split_band && options.frequency_lo >= options.frequency_hi)
     throw std::runtime_error("split point must be below the inversion carrier");
 
@@ -21,6 +21,12 @@ sub main {
   system("uname -rms");
 
   testSimpleInversion();
+  testSplitBandInversion();
+  testSplitBandImagesAtLowSampleRate();
+  testResumeFromCheckpoint();
+  testFollowGrowingFile();
+  testCheckpointOfOtherFileIsRefused();
+  testFixedPointAgainstFloat();
 
   print $has_failures ? "Tests did not pass\n" : "All passed\n";
 
@@ -36,6 +42,216 @@ sub testSimpleInversion {
   return;
 }
 
+sub testSplitBandInversion {
+  my $inversion_carrier = 3500;
+  my $split_frequency   = 1200;
+  for my $test_frequency ( 500, 800, 1800, 2500 ) {
+    generateTestSoundWithSimpleBeep($test_frequency);
+    deinvertTestFileWithOptions( "-f " . $inversion_carrier . " -s " . $split_frequency );
+    my $measured_frequency = findFrequencyOfOutputFile();
+    my $expected_frequency =
+      $test_frequency < $split_frequency
+      ? calculateExpectedInvertedFrequency( $test_frequency, $split_frequency )
+      : calculateExpectedInvertedFrequency( $test_frequency,
+      $split_frequency + $inversion_carrier );
+
+    my $result = abs( $expected_frequency - $measured_frequency ) < 2;
+    check( $result,
+          "Split at "
+        . $split_frequency
+        . " Hz, carrier "
+        . $inversion_carrier . " Hz: "
+        . $test_frequency
+        . " Hz  becomes "
+        . $measured_frequency
+        . ", should be ~"
+        . $expected_frequency );
+  }
+  return;
+}
+
+# At a low sample rate the high band's mixing image folds back close to the carrier;
+# none of it should make it to the output
+sub testSplitBandImagesAtLowSampleRate {
+  my $inversion_carrier = 3500;
+  my $split_frequency   = 1200;
+  for my $test_frequency ( 3000, 3300, 3450 ) {
+    generateTestSoundWithSimpleBeep( $test_frequency, "12k" );
+    deinvertTestFileWithOptions(
+      "-f " . $inversion_carrier . " -s " . $split_frequency . " -q 3" );
+
+    my $total_rms = rmsOfSoxCommand("sox $output_file -n stat");
+    my $above_carrier_rms =
+      rmsOfSoxCommand( "sox $output_file -n sinc " . ( $inversion_carrier + 200 ) . " stat" );
+    my $ratio =
+      ( $total_rms > 0 && $above_carrier_rms > 0 )
+      ? 20 * log( $above_carrier_rms / $total_rms ) / log(10)
+      : ( $total_rms > 0 ? -999 : 0 );
+
+    check( $ratio < -40,
+          "Split at "
+        . $split_frequency
+        . " Hz, carrier "
+        . $inversion_carrier
+        . " Hz, 12 kHz: "
+        . $test_frequency
+        . " Hz has "
+        . sprintf( "%.1f", $ratio )
+        . " dB above the carrier, should be < -40" );
+  }
+  return;
+}
+
+# Process the first half of a file with a checkpoint, then the whole file: the result
+# should be the same as processing the whole file in one go. The file is long enough for
+# a periodic checkpoint to be saved along the way.
+sub testResumeFromCheckpoint {
+  my $direct_file     = "direct.wav";
+  my $growing_file    = "growing.wav";
+  my $checkpoint_file = "checkpoint.bin";
+
+  generateTestSoundWithSimpleBeep( 600, "48k", 25 );
+  deinvertTestFileWithOptions("-f 2632");
+  rename( $output_file, $direct_file );
+
+  unlink($checkpoint_file);
+  system("sox $test_file $growing_file trim 0 12.5");
+  system("$binary -i $growing_file -o $output_file -f 2632 -c $checkpoint_file");
+  system("cp $test_file $growing_file");
+  system("$binary -i $growing_file -o $output_file -f 2632 -c $checkpoint_file");
+
+  checkThatOutputMatches( $direct_file, "Resumed output" );
+
+  unlink( $direct_file, $growing_file, $checkpoint_file );
+  return;
+}
+
+# Follow a file that grows while we're reading it, like a recording in progress, and
+# stop with SIGINT: the output should be complete and match a direct run
+sub testFollowGrowingFile {
+  my $direct_file     = "direct.wav";
+  my $growing_file    = "growing.wav";
+  my $checkpoint_file = "checkpoint.bin";
+
+  generateTestSoundWithSimpleBeep( 600, "48k", 25 );
+  deinvertTestFileWithOptions("-f 2632");
+  rename( $output_file, $direct_file );
+
+  # Like a recorder that has written the header but only 12 seconds of audio so far
+  my $num_samples = qx!soxi -s $test_file!;
+  chomp($num_samples);
+  my $header_size = ( -s $test_file ) - 2 * $num_samples;
+  my $first_part  = $header_size + 2 * 48000 * 12;
+  system("head -c $first_part $test_file > $growing_file");
+
+  unlink($checkpoint_file);
+  my $pid = fork();
+  croak 'fork failed' if ( !defined $pid );
+  if ( $pid == 0 ) {
+    exec( "timeout -s INT 8 $binary -i $growing_file -o $output_file -f 2632 -F "
+        . "-c $checkpoint_file" );
+  }
+
+  sleep 3;
+  system( "tail -c +" . ( $first_part + 1 ) . " $test_file >> $growing_file" );
+  waitpid( $pid, 0 );
+
+  checkThatOutputMatches( $direct_file, "Followed output" );
+
+  unlink( $direct_file, $growing_file, $checkpoint_file );
+  return;
+}
+
+# A checkpoint saved for one input must not be used to resume another one
+sub testCheckpointOfOtherFileIsRefused {
+  my $other_file      = "other.wav";
+  my $saved_output    = "saved_output.wav";
+  my $checkpoint_file = "checkpoint.bin";
+
+  generateTestSoundWithSimpleBeep(600);
+  unlink($checkpoint_file);
+  system("$binary -i $test_file -o $output_file -f 2632 -c $checkpoint_file");
+  system("cp $output_file $saved_output");
+
+  system("cp $test_file $other_file");
+  my $status =
+    system("$binary -i $other_file -o $output_file -f 2632 -c $checkpoint_file 2>/dev/null");
+  my $is_output_untouched = system("cmp -s $output_file $saved_output") == 0;
+
+  check( $status != 0 && $is_output_untouched,
+    "Checkpoint of another input file is refused and the output is left untouched" );
+
+  unlink( $other_file, $saved_output, $checkpoint_file );
+  return;
+}
+
+sub checkThatOutputMatches {
+  my ( $reference_file, $description ) = @_;
+
+  my $reference_length = qx!soxi -s $reference_file!;
+  my $output_length    = qx!soxi -s $output_file!;
+  chomp( $reference_length, $output_length );
+
+  my $max_difference = 0;
+  for (qx!sox -m -v 1 $reference_file -v -1 $output_file -n stat 2>&1!) {
+    if (/^M(?:ax|in)imum amplitude:\s+-?([\d\.]+)/) {
+      $max_difference = $1 if ( $1 > $max_difference );
+    }
+  }
+
+  check( $reference_length == $output_length && $max_difference < 0.001,
+        $description . " has "
+      . $output_length
+      . " samples, max difference "
+      . $max_difference
+      . "; should be "
+      . $reference_length
+      . ", ~0" );
+  return;
+}
+
+# The fixed-point path should be close to the float path on a raw stream, and faster
+sub testFixedPointAgainstFloat {
+  my $raw_input    = "test.raw";
+  my $float_output = "float.raw";
+  my $fixed_output = "fixed.raw";
+  my $raw_format   = "-t s16 -r 48k -c 1";
+
+  generateTestSoundWithSimpleBeep(700);
+  system("sox $test_file $raw_format $raw_input");
+
+  for my $quality ( 0 .. 3 ) {
+    system("$binary -r 48000 -f 2632 -q $quality < $raw_input > $float_output");
+    system("$binary -r 48000 -f 2632 -q $quality -x < $raw_input > $fixed_output");
+
+    my $signal_rms = rmsOfSoxCommand("sox $raw_format $float_output -n stat");
+    my $noise_rms  = rmsOfSoxCommand(
+      "sox -m $raw_format -v 1 $float_output $raw_format -v -1 $fixed_output -n stat");
+    my $snr = 0;
+    if ( $signal_rms > 0 ) {
+      $snr = $noise_rms > 0 ? 20 * log( $signal_rms / $noise_rms ) / log(10) : 999;
+    }
+
+    check( $snr > 50,
+          "Fixed point at quality "
+        . $quality
+        . ": SNR against float "
+        . sprintf( "%.1f", $snr )
+        . " dB, should be > 50" );
+  }
+
+  unlink( $raw_input, $float_output, $fixed_output );
+  return;
+}
+
+sub rmsOfSoxCommand {
+  my ($command) = @_;
+  for (qx!$command 2>&1!) {
+    return $1 if (/^RMS\s+amplitude:\s+([\d\.]+)/);
+  }
+  return 0;
+}
+
 sub checkThatFrequencyInvertsAsItShould {
   my ($test_frequency, $inversion_carrier) = @_;
   generateTestSoundWithSimpleBeep($test_frequency);
@@ -58,10 +274,12 @@ sub checkThatFrequencyInvertsAsItShould {
 }
 
 sub generateTestSoundWithSimpleBeep {
-  my ($test_frequency) = @_;
+  my ( $test_frequency, $samplerate, $length ) = @_;
+  $samplerate //= "48k";
+  $length     //= 5;
   unlink($test_file);
-  system( "sox -n -c 1 -e signed -b 16 -r 48k $test_file "
-      . "synth sin $test_frequency trim 0 5 vol 0.5 fade 0.2" );
+  system( "sox -n -c 1 -e signed -b 16 -r $samplerate $test_file "
+      . "synth sin $test_frequency trim 0 $length vol 0.5 fade 0.2" );
   return;
 }
 